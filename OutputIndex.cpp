@@ -0,0 +1,65 @@
+#include <algorithm>
+#include "OutputIndex.h"
+
+OutputIndex::OutputIndex(Display* display, Window root)
+{
+  auto* resources = XRRGetScreenResourcesCurrent(display, root);
+  if (resources == nullptr)
+  {
+    std::cerr << "XRRGetScreenResourcesCurrent failed" << std::endl;
+    return;
+  }
+
+  for (int i = 0; i < resources->ncrtc; i++)
+  {
+    auto* crtc = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
+    if (crtc == nullptr)
+    {
+      continue;
+    }
+
+    // Disabled CRTCs have no mode
+    if (crtc->mode != None && crtc->width > 0 && crtc->height > 0)
+    {
+      _outputs.emplace_back(Output{
+          resources->crtcs[i], {crtc->x, crtc->y, crtc->width, crtc->height}});
+    }
+
+    XRRFreeCrtcInfo(crtc);
+  }
+
+  XRRFreeScreenResources(resources);
+}
+
+OutputIndex OutputIndex::Changed(const OutputIndex& current) const
+{
+  OutputIndex changed;
+  std::copy_if(_outputs.begin(),
+               _outputs.end(),
+               std::back_inserter(changed._outputs),
+               [&](const auto& e) {
+                 return std::none_of(current._outputs.begin(),
+                                     current._outputs.end(),
+                                     [&](const auto& other) {
+                                       return other.crtc == e.crtc &&
+                                              other.rect == e.rect;
+                                     });
+               });
+
+  return changed;
+}
+
+bool OutputIndex::Intersects(const Position& position) const
+{
+  return std::any_of(_outputs.begin(), _outputs.end(), [&](const auto& e) {
+    return position.x < e.rect.x + static_cast<int>(e.rect.width) &&
+           e.rect.x < position.x + static_cast<int>(position.width) &&
+           position.y < e.rect.y + static_cast<int>(e.rect.height) &&
+           e.rect.y < position.y + static_cast<int>(position.height);
+  });
+}
+
+bool OutputIndex::Empty() const
+{
+  return _outputs.empty();
+}
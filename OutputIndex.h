@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+#include "Position.h"
+
+/*
+ * Rectangles of the active CRTCs, used to find which outputs a window is on.
+ * There are only ever a handful of outputs, so lookups are a linear scan.
+ */
+class OutputIndex
+{
+  public:
+    OutputIndex() = default;
+    OutputIndex(Display* display, Window root);
+
+    // Outputs of this layout that are gone or were moved / resized in 'current'
+    OutputIndex Changed(const OutputIndex& current) const;
+
+    bool Intersects(const Position& position) const;
+
+    bool Empty() const;
+
+  private:
+    struct Output
+    {
+      RRCrtc crtc;
+      Position rect;
+    };
+
+    std::vector<Output> _outputs;
+};
@@ -5,3 +5,9 @@ std::ostream& operator<<(std::ostream& str, const Position& position)
   return str << "x=" << position.x << ", y=" << position.y
              << ", width=" << position.width << ", height= " << position.height;
 }
+
+bool operator==(const Position& left, const Position& right)
+{
+  return left.x == right.x && left.y == right.y &&
+         left.width == right.width && left.height == right.height;
+}
@@ -10,3 +10,4 @@ struct Position
 };
 
 std::ostream& operator<<(std::ostream& str, const Position& position);
+bool operator==(const Position& left, const Position& right);
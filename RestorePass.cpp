@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <thread>
+#include "RestorePass.h"
+
+RestorePass::RestorePass(Display* display)
+    : _display(display),
+      _maximized_vert(
+          XInternAtom(_display, "_NET_WM_STATE_MAXIMIZED_VERT", true)),
+      _maximized_horz(
+          XInternAtom(_display, "_NET_WM_STATE_MAXIMIZED_HORZ", true)),
+      _fullscreen(XInternAtom(_display, "_NET_WM_STATE_FULLSCREEN", true))
+{
+}
+
+void RestorePass::Add(const XWindow& window,
+                      const Position& position,
+                      const std::vector<unsigned long>& state)
+{
+  _entries.emplace_back(Entry{window, position, GetFlags(state), {}, false});
+}
+
+RestorePass::Flags
+RestorePass::GetFlags(const std::vector<unsigned long>& state) const
+{
+  Flags flags{};
+  for (auto atom : state)
+  {
+    if (atom == _fullscreen)
+    {
+      flags.fullscreen = true;
+    }
+    else if (atom == _maximized_vert || atom == _maximized_horz)
+    {
+      flags.maximized.emplace_back(atom);
+    }
+  }
+
+  std::sort(flags.maximized.begin(), flags.maximized.end());
+  return flags;
+}
+
+void RestorePass::Query()
+{
+  /*
+   * Xlib can't pipeline replies, so this is still one round trip per query,
+   * but all of them happen before any message is sent so the window manager
+   * isn't reacting to the pass while it's being planned
+   */
+  for (auto& e : _entries)
+  {
+    auto position = e.window.CurrentPosition();
+    if (!position)
+    {
+      e.failed = true;
+      continue;
+    }
+
+    auto state = e.window.WmState();
+    if (!state)
+    {
+      e.failed = true;
+      continue;
+    }
+
+    auto current = GetFlags(state.Value());
+    auto& plan = e.plan;
+
+    plan.move = position.Value() != e.position;
+    if (plan.move)
+    {
+      // Moving requires clearing all the flags first, see Run()
+      plan.unset_fullscreen = current.fullscreen;
+      plan.set_fullscreen = e.saved.fullscreen;
+      plan.unset_maximized = current.maximized;
+      plan.set_maximized = e.saved.maximized;
+    }
+    else
+    {
+      plan.unset_fullscreen = current.fullscreen && !e.saved.fullscreen;
+      plan.set_fullscreen = e.saved.fullscreen && !current.fullscreen;
+      std::set_difference(current.maximized.begin(),
+                          current.maximized.end(),
+                          e.saved.maximized.begin(),
+                          e.saved.maximized.end(),
+                          std::back_inserter(plan.unset_maximized));
+      std::set_difference(e.saved.maximized.begin(),
+                          e.saved.maximized.end(),
+                          current.maximized.begin(),
+                          current.maximized.end(),
+                          std::back_inserter(plan.set_maximized));
+    }
+
+    plan.active = plan.move || plan.unset_fullscreen || plan.set_fullscreen ||
+                  !plan.unset_maximized.empty() || !plan.set_maximized.empty();
+  }
+}
+
+template <typename Filter, typename Routine>
+void RestorePass::Phase(Filter filter, Routine routine)
+{
+  bool sent = false;
+  for (auto& e : _entries)
+  {
+    if (e.failed || !e.plan.active || !filter(e.plan))
+    {
+      continue;
+    }
+
+    auto result = routine(e);
+    sent = true;
+    if (result)
+    {
+      // Client messages go to the root window and can't fail on their own
+      e.window.Probe();
+    }
+    else
+    {
+      e.failed = true;
+      if (result.Error().error_code != BadWindow)
+      {
+        std::cerr << "Error while restoring window: " << e.window.WindowHandle()
+                  << ", " << result.Error() << std::endl;
+      }
+    }
+  }
+
+  if (!sent)
+  {
+    return;
+  }
+
+  // Errors from this phase are all dispatched once the sync returns
+  XSync(_display, False);
+  for (auto& e : _entries)
+  {
+    if (!e.failed && XErrorTracker::Dead(e.window.WindowHandle()))
+    {
+      e.failed = true;
+    }
+  }
+}
+
+void RestorePass::Run()
+{
+  /*
+   * Experiments have shown that sending a MOVERSIZE_WINDOW event don't work
+   * under gnome & derivates if any of the MAXIMIZED_* flags are set.
+   * To work around that, this method removes these flags before moving, and
+   * then sets the ones the window had when it was saved
+   */
+
+  Query();
+
+  Phase([](const Plan& plan) { return plan.unset_fullscreen; },
+        [&](Entry& e) {
+          std::cerr << "Removing fullscreen state from window "
+                    << e.window.WindowHandle() << std::endl;
+          return e.window.SetWmState({_fullscreen}, false);
+        });
+
+  Phase([](const Plan& plan) { return !plan.unset_maximized.empty(); },
+        [&](Entry& e) {
+          return e.window.SetWmState(e.plan.unset_maximized, false);
+        });
+
+  Phase([](const Plan& plan) { return plan.move; },
+        [&](Entry& e) {
+          std::cerr << "Restoring window: " << e.window.WindowHandle() << " -> "
+                    << e.position << std::endl;
+          return e.window.MoveResize(e.position);
+        });
+
+  Phase([](const Plan& plan) { return !plan.set_maximized.empty(); },
+        [&](Entry& e) {
+          return e.window.SetWmState(e.plan.set_maximized, true);
+        });
+
+  if (std::none_of(_entries.begin(), _entries.end(), [](const auto& e) {
+        return e.plan.set_fullscreen && !e.failed;
+      }))
+  {
+    return;
+  }
+
+  // One wait for all fullscreen windows instead of one per window
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  Phase([](const Plan& plan) { return plan.set_fullscreen; },
+        [&](Entry& e) { return e.window.SetWmState({_fullscreen}, true); });
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <X11/Xlib.h>
+#include "XWindow.h"
+
+/*
+ * Restores the position and maximized / fullscreen state of a set of
+ * windows. The current geometry and state of every window is queried first,
+ * and only windows that differ from their saved state get client messages.
+ * Those are queued and sent in a few ordered phases, each one flushed and
+ * fenced by a single XSync.
+ */
+class RestorePass
+{
+  public:
+    RestorePass(Display* display);
+
+    void Add(const XWindow& window,
+             const Position& position,
+             const std::vector<unsigned long>& state);
+
+    void Run();
+
+  private:
+    // Minimal set of operations needed to bring a window back in place
+    struct Plan
+    {
+      bool active;
+      bool move;
+      bool unset_fullscreen;
+      bool set_fullscreen;
+      std::vector<unsigned long> unset_maximized;
+      std::vector<unsigned long> set_maximized;
+    };
+
+    // Maximized / fullscreen flags, the only ones restoring has to care about
+    struct Flags
+    {
+      std::vector<unsigned long> maximized;
+      bool fullscreen;
+    };
+
+    struct Entry
+    {
+      XWindow window;
+      Position position;
+      Flags saved;
+      Plan plan;
+      bool failed;
+    };
+
+    Flags GetFlags(const std::vector<unsigned long>& state) const;
+
+    void Query();
+
+    template <typename Filter, typename Routine>
+    void Phase(Filter filter, Routine routine);
+
+  private:
+    Display* _display;
+    Atom _maximized_vert;
+    Atom _maximized_horz;
+    Atom _fullscreen;
+    std::vector<Entry> _entries;
+};
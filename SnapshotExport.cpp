@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SnapshotExport.h"
+#include "RuntimeError.h"
+
+// Returns true if 'name' is an export left behind by a daemon that is gone
+static bool Stale(const std::string& name)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat info{};
+  if (fstat(fd, &info) != 0 ||
+      info.st_size != static_cast<off_t>(sizeof(ExportedSnapshot)))
+  {
+    close(fd);
+    return false;
+  }
+
+  auto* addr =
+      mmap(nullptr, sizeof(ExportedSnapshot), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (addr == MAP_FAILED)
+  {
+    return false;
+  }
+
+  const auto* snapshot = static_cast<const ExportedSnapshot*>(addr);
+  bool stale = snapshot->magic == ExportMagic &&
+               kill(static_cast<pid_t>(snapshot->pid), 0) != 0 &&
+               errno == ESRCH;
+
+  munmap(addr, sizeof(ExportedSnapshot));
+  return stale;
+}
+
+SnapshotExport::SnapshotExport(const std::string& name)
+{
+  if (name.empty())
+  {
+    throw RuntimeError("Shared memory name can't be empty");
+  }
+
+  _name = name.front() == '/' ? name : "/" + name;
+
+  // Titles can be sensitive, so the region is private to the current user
+  int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST && Stale(_name))
+  {
+    std::cerr << "Replacing stale export " << _name << std::endl;
+
+    shm_unlink(_name.c_str());
+    fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+
+  if (fd < 0 && errno == EEXIST)
+  {
+    throw RuntimeError(_name + " already exists and isn't a stale export");
+  }
+  else if (fd < 0)
+  {
+    throw RuntimeError("shm_open failed for " + _name + ", " +
+                       std::to_string(errno));
+  }
+
+  if (ftruncate(fd, sizeof(ExportedSnapshot)) != 0)
+  {
+    auto error = errno;
+    close(fd);
+    shm_unlink(_name.c_str());
+    throw RuntimeError("ftruncate failed, " + std::to_string(error));
+  }
+
+  auto* addr = mmap(nullptr,
+                    sizeof(ExportedSnapshot),
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED,
+                    fd,
+                    0);
+  close(fd);
+
+  if (addr == MAP_FAILED)
+  {
+    shm_unlink(_name.c_str());
+    throw RuntimeError("mmap failed, " + std::to_string(errno));
+  }
+
+  // The region is zero filled by ftruncate, so the generation starts at 0
+  _snapshot = new (addr) ExportedSnapshot{};
+  _snapshot->magic = ExportMagic;
+  _snapshot->version = ExportVersion;
+  _snapshot->pid = getpid();
+}
+
+SnapshotExport::~SnapshotExport()
+{
+  munmap(_snapshot, sizeof(ExportedSnapshot));
+  shm_unlink(_name.c_str());
+}
+
+void SnapshotExport::Publish(const std::vector<WindowState>& state,
+                             bool all_screens_present)
+{
+  auto generation = _snapshot->generation.load(std::memory_order_relaxed);
+  _snapshot->generation.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  _snapshot->timestamp_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+  _snapshot->all_screens_present = all_screens_present;
+  _snapshot->total_windows = state.size();
+  _snapshot->window_count = std::min(state.size(), ExportMaxWindows);
+
+  for (size_t i = 0; i < _snapshot->window_count; i++)
+  {
+    auto& window = _snapshot->windows[i];
+    window.window = state[i].window.WindowHandle();
+    window.x = state[i].position.x;
+    window.y = state[i].position.y;
+    window.width = state[i].position.width;
+    window.height = state[i].position.height;
+
+    const auto& title = state[i].identity.title;
+    auto length = std::min(title.size(), ExportMaxTitle - 1);
+    memcpy(window.title, title.data(), length);
+    window.title[length] = '\0';
+  }
+
+  _snapshot->generation.store(generation + 2, std::memory_order_release);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "WindowState.h"
+
+/*
+ * Binary layout of the shared memory region the daemon publishes its state
+ * in. The region is only accessible to the user running the daemon.
+ * Readers map the region read-only and use the generation counter as a
+ * seqlock:
+ *
+ *   1) Read the generation (acquire), retry while it's odd
+ *   2) Copy the fields they need
+ *   3) Issue an acquire fence, then re-read the generation
+ *   4) Retry if it changed
+ *
+ * Reads don't need any syscall. The region does outlive a daemon that is
+ * killed though, so readers should check once, when mapping it, that 'pid'
+ * is running (e.g. kill(pid, 0)), otherwise the content is stale.
+ * A new daemon replaces a stale region, but refuses to start if its owner
+ * is alive.
+ */
+constexpr uint32_t ExportMagic = 0x544d564b; // "KVMT"
+constexpr uint32_t ExportVersion = 1;
+constexpr size_t ExportMaxWindows = 512;
+constexpr size_t ExportMaxTitle = 128;
+
+struct ExportedWindow
+{
+  uint64_t window;
+  int32_t x;
+  int32_t y;
+  uint32_t width;
+  uint32_t height;
+  char title[ExportMaxTitle]; // Truncated, always null terminated
+};
+
+struct ExportedSnapshot
+{
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<uint64_t> generation; // Odd while an update is in progress
+  uint64_t timestamp_ms;            // Unix time of the last update
+  uint32_t pid;                     // Process id of the publishing daemon
+  uint32_t all_screens_present;
+  uint32_t window_count;            // Entries of 'windows' that are valid
+  uint32_t total_windows;           // Above window_count if it was truncated
+  ExportedWindow windows[ExportMaxWindows];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The generation counter must be usable across processes");
+
+class SnapshotExport
+{
+  public:
+    SnapshotExport(const std::string& name);
+    ~SnapshotExport();
+
+    SnapshotExport(const SnapshotExport& other) = delete;
+    SnapshotExport& operator=(const SnapshotExport& other) = delete;
+
+    void Publish(const std::vector<WindowState>& state, bool all_screens_present);
+
+  private:
+    std::string _name;
+    ExportedSnapshot* _snapshot;
+};
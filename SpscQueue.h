@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <optional>
+
+/*
+ * Lock-free ring buffer for exactly one producer thread and one consumer
+ * thread. Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  public:
+    // Producer side, returns false if the queue is full
+    bool Push(const T& value)
+    {
+      auto tail = _tail.load(std::memory_order_relaxed);
+      if (tail - _head.load(std::memory_order_acquire) == Capacity)
+      {
+        return false;
+      }
+
+      _items[tail & (Capacity - 1)] = value;
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side, returns nothing if the queue is empty
+    std::optional<T> Pop()
+    {
+      auto head = _head.load(std::memory_order_relaxed);
+      if (head == _tail.load(std::memory_order_acquire))
+      {
+        return {};
+      }
+
+      T value = _items[head & (Capacity - 1)];
+      _head.store(head + 1, std::memory_order_release);
+      return value;
+    }
+
+  private:
+    std::array<T, Capacity> _items{};
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+};
@@ -0,0 +1,29 @@
+#include <functional>
+#include "WindowIdentity.h"
+
+size_t WindowIdentityHash::operator()(const WindowIdentity& identity) const
+{
+  std::hash<std::string> hash;
+
+  size_t seed = 0;
+  for (const auto* e :
+       {&identity.wm_class, &identity.command, &identity.role, &identity.title})
+  {
+    seed ^= hash(*e) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+
+  return seed;
+}
+
+std::ostream& operator<<(std::ostream& str, const WindowIdentity& identity)
+{
+  return str << "class=" << identity.wm_class
+             << ", command=" << identity.command << ", role=" << identity.role
+             << ", title=" << identity.title;
+}
+
+bool operator==(const WindowIdentity& left, const WindowIdentity& right)
+{
+  return left.wm_class == right.wm_class && left.command == right.command &&
+         left.role == right.role && left.title == right.title;
+}
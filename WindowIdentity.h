@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+/*
+ * Identifies a window independently of its X id, so that it can be matched
+ * again after the application re-creates it or restarts.
+ */
+struct WindowIdentity
+{
+  std::string wm_class;
+  std::string command;
+  std::string role;
+  std::string title;
+};
+
+struct WindowIdentityHash
+{
+  size_t operator()(const WindowIdentity& identity) const;
+};
+
+std::ostream& operator<<(std::ostream& str, const WindowIdentity& identity);
+bool operator==(const WindowIdentity& left, const WindowIdentity& right);
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include "WindowIndex.h"
+
+size_t WindowIndex::Add(Window window, const WindowIdentity& identity)
+{
+  auto id = _titles.size();
+
+  _windows.emplace(window, id);
+  _identities.emplace(identity, id);
+  _untitled.emplace(WithoutTitle(identity), id);
+  _titles.emplace_back(identity.title);
+  _claimed.emplace_back(false);
+
+  return id;
+}
+
+std::optional<size_t> WindowIndex::Claim(Window window)
+{
+  auto it = _windows.find(window);
+  if (it == _windows.end() || _claimed[it->second])
+  {
+    return {};
+  }
+
+  _claimed[it->second] = true;
+  return it->second;
+}
+
+std::optional<size_t> WindowIndex::Claim(const WindowIdentity& identity)
+{
+  if (auto id = ClaimExact(identity); id.has_value())
+  {
+    return id;
+  }
+
+  return ClaimClosest(identity);
+}
+
+std::optional<size_t> WindowIndex::ClaimExact(const WindowIdentity& identity)
+{
+  auto [begin, end] = _identities.equal_range(identity);
+  for (auto it = begin; it != end; it++)
+  {
+    if (!_claimed[it->second])
+    {
+      _claimed[it->second] = true;
+      return it->second;
+    }
+  }
+
+  return {};
+}
+
+std::optional<size_t> WindowIndex::ClaimClosest(const WindowIdentity& identity)
+{
+  // Without a class, the title is all there is to go on
+  if (identity.wm_class.empty())
+  {
+    return {};
+  }
+
+  // Titles tend to change at the end (current tab, directory, document)
+  auto common_prefix = [&](const std::string& title) {
+    auto mismatch = std::mismatch(
+        title.begin(), title.end(), identity.title.begin(), identity.title.end());
+    return mismatch.first - title.begin();
+  };
+
+  std::optional<size_t> best;
+  long best_prefix = -1;
+
+  auto [begin, end] = _untitled.equal_range(WithoutTitle(identity));
+  for (auto it = begin; it != end; it++)
+  {
+    if (_claimed[it->second])
+    {
+      continue;
+    }
+
+    long prefix = common_prefix(_titles[it->second]);
+    if (prefix > best_prefix)
+    {
+      best = it->second;
+      best_prefix = prefix;
+    }
+  }
+
+  if (best.has_value())
+  {
+    _claimed[best.value()] = true;
+  }
+
+  return best;
+}
+
+WindowIdentity WindowIndex::WithoutTitle(const WindowIdentity& identity)
+{
+  return {identity.wm_class, identity.command, identity.role, {}};
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <X11/Xlib.h>
+#include "WindowIdentity.h"
+
+/*
+ * Matches freshly enumerated windows against saved ones, either by X id, or
+ * by identity. Identities are matched exactly first, and then without title,
+ * picking the saved window whose title is closest.
+ * Each saved window can only be claimed once, so all windows should be
+ * claimed by X id before falling back to identities.
+ */
+class WindowIndex
+{
+  public:
+    // Returns the id of the added window, ids are assigned sequentially from 0
+    size_t Add(Window window, const WindowIdentity& identity);
+
+    std::optional<size_t> Claim(Window window);
+
+    std::optional<size_t> Claim(const WindowIdentity& identity);
+
+  private:
+    using IdentityMap =
+        std::unordered_multimap<WindowIdentity, size_t, WindowIdentityHash>;
+
+    std::optional<size_t> ClaimExact(const WindowIdentity& identity);
+
+    std::optional<size_t> ClaimClosest(const WindowIdentity& identity);
+
+    static WindowIdentity WithoutTitle(const WindowIdentity& identity);
+
+  private:
+    std::unordered_map<Window, size_t> _windows;
+    IdentityMap _identities;
+    IdentityMap _untitled;
+    std::vector<std::string> _titles;
+    std::vector<bool> _claimed;
+};
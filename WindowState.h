@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+#include "XWindow.h"
+#include "WindowIdentity.h"
+
+struct WindowState
+{
+  XWindow window;
+  WindowIdentity identity;
+  Position position;
+  std::vector<unsigned long> state;
+};
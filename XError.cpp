@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include "XError.h"
+
+struct TrackedRequest
+{
+  Display* display;
+  unsigned long first_serial;
+  unsigned long last_serial;
+  Window window;
+};
+
+// The event reader thread can raise errors on its own connection
+static std::mutex lock;
+static XErrorHandler fallback_handler = nullptr;
+static std::vector<XErrorTrap*> traps;
+static std::deque<TrackedRequest> tracked_requests;
+static std::unordered_set<Window> dead_windows;
+
+std::ostream& operator<<(std::ostream& str, const XError& error)
+{
+  return str << "error_code=" << static_cast<int>(error.error_code)
+             << ", request_code=" << static_cast<int>(error.request_code)
+             << ", serial=" << error.serial << ", resource=" << error.resource;
+}
+
+XErrorTrap::XErrorTrap(Display* display)
+    : _display(display), _first_serial(NextRequest(display))
+{
+  std::lock_guard<std::mutex> guard(lock);
+  traps.push_back(this);
+}
+
+XErrorTrap::~XErrorTrap()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  traps.erase(std::find(traps.begin(), traps.end(), this));
+}
+
+std::optional<XError> XErrorTrap::Error() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (_errors.empty())
+  {
+    return {};
+  }
+
+  return _errors.front();
+}
+
+XError XErrorTrap::Failure(unsigned char error_code,
+                           unsigned char request_code,
+                           XID resource) const
+{
+  return Error().value_or(
+      XError{error_code, request_code, NextRequest(_display) - 1, resource});
+}
+
+void XErrorTracker::Install(XErrorHandler fallback)
+{
+  fallback_handler = fallback;
+  XSetErrorHandler(&XErrorTracker::OnError);
+}
+
+void XErrorTracker::Track(Display* display,
+                          Window window,
+                          unsigned long requests)
+{
+  // Requests older than the last processed one can't report errors anymore
+  auto processed = LastKnownRequestProcessed(display);
+
+  std::lock_guard<std::mutex> guard(lock);
+  while (!tracked_requests.empty() &&
+         tracked_requests.front().last_serial <= processed)
+  {
+    tracked_requests.pop_front();
+  }
+
+  auto serial = NextRequest(display);
+  tracked_requests.push_back({display, serial, serial + requests - 1, window});
+}
+
+bool XErrorTracker::Dead(Window window)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return dead_windows.find(window) != dead_windows.end();
+}
+
+void XErrorTracker::ClearDead()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  dead_windows.clear();
+}
+
+int XErrorTracker::OnError(Display* display, XErrorEvent* error)
+{
+  XError entry{error->error_code,
+               error->request_code,
+               error->serial,
+               error->resourceid};
+
+  std::unique_lock<std::mutex> guard(lock);
+
+  // Innermost trap first, since it was created last
+  for (auto it = traps.rbegin(); it != traps.rend(); it++)
+  {
+    if ((*it)->_display == display && error->serial >= (*it)->_first_serial)
+    {
+      (*it)->_errors.emplace_back(entry);
+      return 0;
+    }
+  }
+
+  auto request = std::find_if(tracked_requests.begin(),
+                              tracked_requests.end(),
+                              [&](const auto& e) {
+                                return e.display == display &&
+                                       error->serial >= e.first_serial &&
+                                       error->serial <= e.last_serial;
+                              });
+
+  if (request != tracked_requests.end())
+  {
+    if (error->error_code == BadWindow)
+    {
+      dead_windows.insert(request->window);
+      return 0;
+    }
+
+    std::cerr << "Request on window " << request->window << " failed, "
+              << entry << std::endl;
+  }
+
+  guard.unlock();
+  return fallback_handler != nullptr ? fallback_handler(display, error) : 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iostream>
+#include <optional>
+#include <vector>
+#include <X11/Xlib.h>
+
+struct XError
+{
+  unsigned char error_code;
+  unsigned char request_code;
+  unsigned long serial;
+  XID resource;
+};
+
+std::ostream& operator<<(std::ostream& str, const XError& error);
+
+/*
+ * Catches the X errors raised by the synchronous requests issued during its
+ * lifetime. Errors are matched to the trap by request serial number, so
+ * nested traps each see only their own requests.
+ */
+class XErrorTrap
+{
+  public:
+    XErrorTrap(Display* display);
+    ~XErrorTrap();
+
+    XErrorTrap(const XErrorTrap& other) = delete;
+    XErrorTrap& operator=(const XErrorTrap& other) = delete;
+
+    std::optional<XError> Error() const;
+
+    // Returns the error if any, otherwise a client side error for 'request'
+    XError Failure(unsigned char error_code, unsigned char request_code, XID resource) const;
+
+  private:
+    friend class XErrorTracker;
+
+    Display* _display;
+    unsigned long _first_serial;
+    std::vector<XError> _errors;
+};
+
+class XErrorTracker
+{
+  public:
+    /*
+     * Installs the X error handler. Errors that can't be tied to a trap or
+     * to a tracked asynchronous request are forwarded to 'fallback'.
+     */
+    static void Install(XErrorHandler fallback);
+
+    /*
+     * Ties the next 'requests' requests on 'display' to 'window'. Only
+     * requests that name 'window' themselves can fail because of it
+     */
+    static void Track(Display* display, Window window, unsigned long requests = 1);
+
+    // Returns true if an asynchronous request on 'window' failed with BadWindow
+    static bool Dead(Window window);
+
+    static void ClearDead();
+
+  private:
+    friend class XErrorTrap;
+
+    static int OnError(Display* display, XErrorEvent* error);
+};
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <X11/extensions/randr.h>
+#include <X11/extensions/Xrandr.h>
+#include "XEventReader.h"
+#include "RuntimeError.h"
+
+XEventReader::XEventReader() : _display(XOpenDisplay(nullptr))
+{
+  if (_display == nullptr)
+  {
+    throw RuntimeError("Failed to open event display");
+  }
+
+  auto root = XDefaultRootWindow(_display);
+  if (XSelectInput(_display, root, RRScreenChangeNotifyMask) == 0)
+  {
+    XCloseDisplay(_display);
+    throw RuntimeError("XSelectInput failed");
+  }
+
+  XRRSelectInput(_display, root, RRScreenChangeNotifyMask);
+  XFlush(_display);
+
+  _wakeup = eventfd(0, EFD_CLOEXEC);
+  if (_wakeup < 0)
+  {
+    XCloseDisplay(_display);
+    throw RuntimeError("eventfd failed, " + std::to_string(errno));
+  }
+
+  _thread = std::thread(&XEventReader::Run, this);
+}
+
+XEventReader::~XEventReader()
+{
+  _stop = true;
+
+  uint64_t value = 1;
+  if (write(_wakeup, &value, sizeof(value)) != sizeof(value))
+  {
+    std::cerr << "Failed to wake up event reader, " << errno << std::endl;
+  }
+
+  _thread.join();
+
+  close(_wakeup);
+  XCloseDisplay(_display);
+}
+
+std::optional<TimedEvent> XEventReader::Next()
+{
+  return _events.Pop();
+}
+
+void XEventReader::Run()
+{
+  pollfd fds[] = {{ConnectionNumber(_display), POLLIN, 0},
+                  {_wakeup, POLLIN, 0}};
+
+  while (!_stop)
+  {
+    while (XPending(_display) > 0)
+    {
+      TimedEvent event{};
+      XNextEvent(_display, &event.event);
+      event.received = std::chrono::system_clock::now();
+
+      // The policy loop is only expected to fall behind for a restore pass,
+      // so wait for it rather than dropping a screen change
+      while (!_events.Push(event) && !_stop)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+
+    // Only wakes up for X traffic, or when the destructor signals _wakeup
+    poll(fds, 2, -1);
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <X11/Xlib.h>
+#include "SpscQueue.h"
+
+using timepoint = std::chrono::system_clock::time_point;
+
+struct TimedEvent
+{
+  XEvent event;
+  timepoint received;
+};
+
+/*
+ * Reads RandR events on a dedicated X connection and thread, so events are
+ * timestamped when they arrive, even while the main connection is busy
+ * restoring windows.
+ */
+class XEventReader
+{
+  public:
+    XEventReader();
+    ~XEventReader();
+
+    XEventReader(const XEventReader& other) = delete;
+    XEventReader& operator=(const XEventReader& other) = delete;
+
+    // Returns the next received event, without blocking
+    std::optional<TimedEvent> Next();
+
+  private:
+    void Run();
+
+  private:
+    Display* _display;
+    int _wakeup; // eventfd signaled to stop the reader thread
+    std::atomic<bool> _stop{false};
+    SpscQueue<TimedEvent, 64> _events;
+    std::thread _thread;
+};
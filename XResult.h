@@ -0,0 +1,47 @@
+#pragma once
+
+#include <variant>
+#include <utility>
+#include "XError.h"
+
+template <typename T>
+class XResult
+{
+  public:
+    XResult() : _value(T{})
+    {
+    }
+
+    XResult(T value) : _value(std::move(value))
+    {
+    }
+
+    XResult(const XError& error) : _value(error)
+    {
+    }
+
+    explicit operator bool() const
+    {
+      return std::holds_alternative<T>(_value);
+    }
+
+    T& Value()
+    {
+      return std::get<T>(_value);
+    }
+
+    const T& Value() const
+    {
+      return std::get<T>(_value);
+    }
+
+    const XError& Error() const
+    {
+      return std::get<XError>(_value);
+    }
+
+  private:
+    std::variant<T, XError> _value;
+};
+
+using XStatus = XResult<std::monostate>;
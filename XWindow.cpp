@@ -1,10 +1,12 @@
 #include <algorithm>
+#include <fstream>
 #include <X11/Xatom.h>
+#include <X11/Xproto.h>
 #include <map>
 #include <thread>
+#include <unistd.h>
 
 #include "XWindow.h"
-#include "RuntimeError.h"
 
 constexpr auto MaxPropertyName = 40960;
 
@@ -14,11 +16,17 @@ XWindow::XWindow(Display* display, Window window)
 }
 
 template <typename T>
-inline std::enable_if_t<is_vector<T>::value, T>
+inline std::enable_if_t<is_vector<T>::value, XResult<T>>
 XWindow::GetProperty(const char* name, Atom type)
 {
 
-  auto property = GetPropertyImpl(name, type);
+  auto result = GetPropertyImpl(name, type);
+  if (!result)
+  {
+    return result.Error();
+  }
+
+  const auto& property = result.Value();
 
   T output;
   using TElement = std::decay<decltype(*output.begin())>::type;
@@ -31,14 +39,18 @@ XWindow::GetProperty(const char* name, Atom type)
 }
 
 template <typename T>
-inline std::enable_if_t<!is_vector<T>::value, T>
+inline std::enable_if_t<!is_vector<T>::value, XResult<T>>
 XWindow::GetProperty(const char* name, Atom type)
 {
-  auto property = GetPropertyImpl(name, type);
+  auto result = GetPropertyImpl(name, type);
+  if (!result)
+  {
+    return result.Error();
+  }
 
   if constexpr (std::is_same_v<T, std::string>)
   {
-    return std::string{reinterpret_cast<char*>(property.Data())};
+    return std::string{reinterpret_cast<char*>(result.Value().Data())};
   }
   else
   {
@@ -46,7 +58,7 @@ XWindow::GetProperty(const char* name, Atom type)
   }
 }
 
-XProperty XWindow::GetPropertyImpl(const char* name, Atom type)
+XResult<XProperty> XWindow::GetPropertyImpl(const char* name, Atom type)
 {
   Atom actual_type{};
   int ret_format = 0;
@@ -55,6 +67,8 @@ XProperty XWindow::GetPropertyImpl(const char* name, Atom type)
   unsigned char* buffer = nullptr;
 
   auto atom = XInternAtom(_display, name, False);
+
+  XErrorTrap trap(_display);
   auto result = XGetWindowProperty(_display,
                                    _window,
                                    atom,
@@ -70,26 +84,30 @@ XProperty XWindow::GetPropertyImpl(const char* name, Atom type)
 
   if (result != Success)
   {
-    throw RuntimeError("XGetWindowProperty failed, " + std::to_string(result));
+    return trap.Failure(result, X_GetProperty, _window);
   }
 
+  XProperty property{buffer, type, items};
   if (actual_type != type)
   {
-    throw RuntimeError("Unexpected property type: " +
-                       std::to_string(actual_type) + " for property: " + name);
+    return trap.Failure(BadMatch, X_GetProperty, _window);
   }
 
-  return {buffer, type, items};
+  return property;
 }
 
-std::vector<XWindow> XWindow::Children()
+XResult<std::vector<XWindow>> XWindow::Children()
 {
   auto children =
       GetProperty<std::vector<Window>>("_NET_CLIENT_LIST", XA_WINDOW);
+  if (!children)
+  {
+    return children.Error();
+  }
 
   std::vector<XWindow> windows;
-  std::transform(children.begin(),
-                 children.end(),
+  std::transform(children.Value().begin(),
+                 children.Value().end(),
                  std::back_inserter(windows),
                  [&](const auto& e) {
                    return XWindow{_display, e};
@@ -98,19 +116,117 @@ std::vector<XWindow> XWindow::Children()
   return windows;
 }
 
-std::string XWindow::Title()
+XResult<std::string> XWindow::Title()
 {
   return GetProperty<std::string>("_NET_WM_NAME",
                                   XInternAtom(_display, "UTF8_STRING", False));
 }
 
-Position XWindow::CurrentPosition()
+// Turns a list of null terminated fields into a single separated string
+static std::string JoinFields(std::string fields, char separator)
+{
+  std::replace(fields.begin(), fields.end(), '\0', separator);
+
+  auto end = fields.find_last_not_of(separator);
+  fields.erase(end == std::string::npos ? 0 : end + 1);
+
+  return fields;
+}
+
+static std::string CommandLine(unsigned long pid)
+{
+  std::ifstream file("/proc/" + std::to_string(pid) + "/cmdline");
+
+  return JoinFields({std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>()},
+                    ' ');
+}
+
+static const std::string& Hostname()
+{
+  static const std::string hostname = [] {
+    char buffer[256] = {0};
+    if (gethostname(buffer, sizeof(buffer) - 1) != 0)
+    {
+      return std::string{};
+    }
+
+    return std::string{buffer};
+  }();
+
+  return hostname;
+}
+
+XResult<WindowIdentity> XWindow::Identity()
+{
+  auto title = Title();
+  if (!title)
+  {
+    return title.Error();
+  }
+
+  return Identity(std::move(title.Value()));
+}
+
+XResult<WindowIdentity> XWindow::Identity(std::string title)
+{
+  WindowIdentity identity{};
+  identity.title = std::move(title);
+
+  // The other properties are optional, only a dead window is an error
+  auto wm_class = GetProperty<std::vector<char>>("WM_CLASS", XA_STRING);
+  if (wm_class)
+  {
+    // WM_CLASS is "instance\0class\0"
+    identity.wm_class = JoinFields(
+        {wm_class.Value().begin(), wm_class.Value().end()}, '.');
+  }
+  else if (wm_class.Error().error_code == BadWindow)
+  {
+    return wm_class.Error();
+  }
+
+  // _NET_WM_PID is only meaningful in our /proc if the client runs locally
+  auto machine = GetProperty<std::string>("WM_CLIENT_MACHINE", XA_STRING);
+  if (machine && !Hostname().empty() && machine.Value() == Hostname())
+  {
+    auto pid =
+        GetProperty<std::vector<unsigned long>>("_NET_WM_PID", XA_CARDINAL);
+    if (pid && !pid.Value().empty())
+    {
+      identity.command = CommandLine(pid.Value().front());
+    }
+    else if (!pid && pid.Error().error_code == BadWindow)
+    {
+      return pid.Error();
+    }
+  }
+  else if (!machine && machine.Error().error_code == BadWindow)
+  {
+    return machine.Error();
+  }
+
+  auto role = GetProperty<std::string>("WM_WINDOW_ROLE", XA_STRING);
+  if (role)
+  {
+    identity.role = std::move(role.Value());
+  }
+  else if (role.Error().error_code == BadWindow)
+  {
+    return role.Error();
+  }
+
+  return identity;
+}
+
+XResult<Position> XWindow::CurrentPosition()
 {
   Window root{};
   unsigned int _;
   unsigned int __;
   Position position{};
 
+  XErrorTrap trap(_display);
   auto result = XGetGeometry(_display,
                              _window,
                              &root,
@@ -123,7 +239,7 @@ Position XWindow::CurrentPosition()
 
   if (result == 0)
   {
-    throw RuntimeError("GetGeometry failed, " + std::to_string(result));
+    return trap.Failure(BadDrawable, X_GetGeometry, _window);
   }
 
   result = XTranslateCoordinates(_display,
@@ -135,11 +251,16 @@ Position XWindow::CurrentPosition()
                                  &position.y,
                                  &root);
 
+  if (result == 0)
+  {
+    return trap.Failure(BadWindow, X_TranslateCoords, _window);
+  }
+
   return position;
 }
 
-void XWindow::SendRawEvent(const char* type,
-                           const std::vector<unsigned long>& data)
+XStatus XWindow::SendRawEvent(const char* type,
+                              const std::vector<unsigned long>& data)
 {
   XEvent event{};
   event.xclient.type = ClientMessage;
@@ -163,80 +284,48 @@ void XWindow::SendRawEvent(const char* type,
                  SubstructureRedirectMask | SubstructureNotifyMask,
                  &event) == 0)
   {
-    throw RuntimeError("Failed to send event " + std::string(type) +
-                       " on window: " + std::to_string(_window));
+    return XError{BadValue, X_SendEvent, NextRequest(_display) - 1, _window};
   }
 
-  XFlush(_display);
+  return {};
 }
 
-void XWindow::SetPosition(const Position& position)
+XStatus XWindow::MoveResize(const Position& position)
 {
-  /*
-   * Experiments have shown that sending a MOVERSIZE_WINDOW event don't work
-   * under gnome & derivates if any of the MAXIMIZED_* flags are set.
-   * To work around that, this method saves, removes, and restores these flags
-   */
-
-  auto state = WmState();
-
-  auto v_atom = XInternAtom(_display, "_NET_WM_STATE_MAXIMIZED_VERT", true);
-  auto h_atom = XInternAtom(_display, "_NET_WM_STATE_MAXIMIZED_HORZ", true);
-  auto fullscreen = XInternAtom(_display, "_NET_WM_STATE_FULLSCREEN", true);
-
-  auto new_state = state;
-  new_state.erase(std::remove_if(new_state.begin(),
-                                 new_state.end(),
-                                 [&](auto e) {
-                                   return e == v_atom || e == h_atom ||
-                                          e == fullscreen;
-                                 }),
-                  new_state.end());
-
-  if (std::find(state.begin(), state.end(), fullscreen) != state.end())
-  {
-    std::cerr << "Removing fullscreen state from window " << Title()
-              << std::endl;
-    SetWmState({fullscreen}, false);
-  }
-
-  SetWmState({v_atom, h_atom}, false);
-
   int flags = (1 << 8) | (1 << 9) | (1 << 10) | (1 << 11);
-  SendRawEvent("_NET_MOVERESIZE_WINDOW",
-               {static_cast<unsigned long>(flags),
-                static_cast<unsigned long>(position.x),
-                static_cast<unsigned long>(position.y),
-                position.width,
-                position.height});
-
-  SetWmState(state, true);
-  if (std::find(state.begin(), state.end(), fullscreen) != state.end())
-  {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    SetWmState({fullscreen}, true);
-  }
+  return SendRawEvent("_NET_MOVERESIZE_WINDOW",
+                      {static_cast<unsigned long>(flags),
+                       static_cast<unsigned long>(position.x),
+                       static_cast<unsigned long>(position.y),
+                       position.width,
+                       position.height});
 }
 
-std::vector<unsigned long> XWindow::WmState()
+XResult<std::vector<unsigned long>> XWindow::WmState()
 {
   return GetProperty<std::vector<unsigned long>>("_NET_WM_STATE", XA_ATOM);
 }
 
-bool XWindow::GetStateFlag(const char* name)
+XResult<bool> XWindow::GetStateFlag(const char* name)
 {
   auto flags = WmState();
+  if (!flags)
+  {
+    return flags.Error();
+  }
+
   auto atom = XInternAtom(_display, name, true);
 
-  return std::find(flags.begin(), flags.end(), atom) != flags.end();
+  return std::find(flags.Value().begin(), flags.Value().end(), atom) !=
+         flags.Value().end();
 }
 
-void XWindow::SetWmState(const std::vector<unsigned long>& state, bool set)
+XStatus XWindow::SetWmState(const std::vector<unsigned long>& state, bool set)
 {
   auto data = state;
   data.insert(data.begin(), set);
 
-  SendRawEvent("_NET_WM_STATE", data);
+  return SendRawEvent("_NET_WM_STATE", data);
 }
 
 Window XWindow::WindowHandle() const
@@ -244,20 +333,50 @@ Window XWindow::WindowHandle() const
   return _window;
 }
 
-void XWindow::Activate()
+void XWindow::Probe()
+{
+  // A ChangeWindowAttributes with an empty mask changes nothing, but the
+  // server still validates the window
+  XSetWindowAttributes attributes{};
+  XErrorTracker::Track(_display, _window);
+  XChangeWindowAttributes(_display, _window, 0, &attributes);
+}
+
+XStatus XWindow::Activate()
 {
-  SendRawEvent("_NET_ACTIVE_WINDOW", {});
+  if (auto result = SendRawEvent("_NET_ACTIVE_WINDOW", {}); !result)
+  {
+    return result;
+  }
+
+  // XMapRaised is a ConfigureWindow followed by a MapWindow
+  XErrorTracker::Track(_display, _window, 2);
   XMapRaised(_display, _window);
+  XFlush(_display);
 
-  auto fullscreen = XInternAtom(_display, "_NET_WM_STATE_FULLSCREEN", true);
-  auto state = WmState();
-  if (std::find(state.begin(), state.end(), fullscreen) != state.end())
+  auto fullscreen = GetStateFlag("_NET_WM_STATE_FULLSCREEN");
+  if (!fullscreen)
+  {
+    return fullscreen.Error();
+  }
+
+  if (fullscreen.Value())
   {
     // Corner case for fullscreen windows: They can be 'broken' if they aren't
     // set to non-fullscreen and back
-    SetWmState({fullscreen}, false);
+    auto atom = XInternAtom(_display, "_NET_WM_STATE_FULLSCREEN", true);
+    if (auto result = SetWmState({atom}, false); !result)
+    {
+      return result;
+    }
 
+    XFlush(_display);
     std::this_thread::sleep_for(std::chrono::seconds(3));
-    SetWmState({fullscreen}, true);
+    auto result = SetWmState({atom}, true);
+    XFlush(_display);
+
+    return result;
   }
+
+  return {};
 }
@@ -8,39 +8,50 @@
 #include "traits.h"
 #include "Position.h"
 #include "XProperty.h"
+#include "XResult.h"
+#include "WindowIdentity.h"
 
 class XWindow
 {
   public:
     XWindow(Display* display, Window window);
 
-    std::vector<XWindow> Children();
-    Position CurrentPosition();
+    XResult<std::vector<XWindow>> Children();
+    XResult<Position> CurrentPosition();
 
-    std::string Title();
+    XResult<std::string> Title();
 
-    void SetPosition(const Position& position);
+    XResult<WindowIdentity> Identity();
+
+    // Same as Identity(), for a window whose title is already known
+    XResult<WindowIdentity> Identity(std::string title);
+
+    // Client messages are only queued, the caller is responsible for flushing
+    XStatus MoveResize(const Position& position);
     
-    std::vector<unsigned long> WmState();
+    XResult<std::vector<unsigned long>> WmState();
 
-    void SetWmState(const std::vector<unsigned long>& state, bool set);
+    XStatus SetWmState(const std::vector<unsigned long>& state, bool set);
 
     Window WindowHandle() const;
 
-    void Activate();
+    // Queues a no-op request on the window, which fails if the window is gone
+    void Probe();
+
+    XStatus Activate();
 
   private:
     template <typename T>
-    std::enable_if_t<is_vector<T>::value, T> GetProperty(const char* name, Atom type);
+    std::enable_if_t<is_vector<T>::value, XResult<T>> GetProperty(const char* name, Atom type);
 
     template <typename T>
-    std::enable_if_t<!is_vector<T>::value, T> GetProperty(const char* name, Atom type);
+    std::enable_if_t<!is_vector<T>::value, XResult<T>> GetProperty(const char* name, Atom type);
 
-    XProperty GetPropertyImpl(const char* name, Atom type);
+    XResult<XProperty> GetPropertyImpl(const char* name, Atom type);
 
-    void SendRawEvent(const char* type, const std::vector<unsigned long>& data);
+    XStatus SendRawEvent(const char* type, const std::vector<unsigned long>& data);
 
-    bool GetStateFlag(const char* name);
+    XResult<bool> GetStateFlag(const char* name);
     void SetStateFlag(const char* name, bool flag);
 
   private:
@@ -1,99 +1,270 @@
 #include <iostream>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <sstream>
 #include <queue>
 #include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <X11/extensions/randr.h>
 #include <X11/extensions/Xrandr.h>
 #include <getopt.h>
 #include "XWindow.h"
+#include "XEventReader.h"
+#include "RestorePass.h"
+#include "WindowIndex.h"
+#include "WindowState.h"
+#include "OutputIndex.h"
+#include "SnapshotExport.h"
 #include "RuntimeError.h"
 
-struct WindowState
+// Windows can disappear at any point, those are silently dropped
+static void ReportStateError(const XWindow& window, const XError& error)
 {
-  XWindow window;
-  Position position;
-  std::vector<unsigned long> state;
-};
-
-using timepoint = std::chrono::system_clock::time_point;
+  if (error.error_code != BadWindow)
+  {
+    std::cerr << "Couldn't read state for window: " << window.WindowHandle()
+              << ", " << error << std::endl;
+  }
+}
 
 static std::vector<WindowState>
-GetWinddowsState(XWindow& window, const std::vector<std::string>& exclude)
+GetWinddowsState(XWindow& window,
+                 const std::vector<std::string>& exclude,
+                 const std::vector<WindowState>& previous,
+                 const std::unordered_set<Window>& dirty)
 {
+  /*
+   * Windows that were on outputs that went away keep the state saved before,
+   * whether they still exist or not. Only the other windows are queried
+   */
   std::vector<WindowState> windows;
+  std::copy_if(previous.begin(),
+               previous.end(),
+               std::back_inserter(windows),
+               [&](const auto& e) {
+                 return dirty.count(e.window.WindowHandle()) != 0;
+               });
+
+  auto children = window.Children();
+  if (!children)
+  {
+    std::cerr << "Couldn't list windows, " << children.Error() << std::endl;
+    return windows;
+  }
+
+  // Fresh enumeration, windows that died since the last one are gone
+  XErrorTracker::ClearDead();
 
-  for (auto& e : window.Children())
+  // Only the title of a window can change, the rest of its identity is reused
+  std::unordered_map<Window, const WindowIdentity*> identities;
+  for (const auto& e : previous)
   {
-    try
+    identities.emplace(e.window.WindowHandle(), &e.identity);
+  }
+
+  /*
+   * Dirty windows that are gone might be re-created while their output is
+   * missing. New windows matching them are left out of the snapshot, so that
+   * restoring matches them to the dirty entry by identity
+   */
+  WindowIndex orphans;
+  if (!dirty.empty())
+  {
+    std::unordered_set<Window> alive;
+    for (const auto& e : children.Value())
+    {
+      alive.insert(e.WindowHandle());
+    }
+
+    for (const auto& e : previous)
+    {
+      auto handle = e.window.WindowHandle();
+      if (dirty.count(handle) != 0 && alive.count(handle) == 0)
+      {
+        orphans.Add(handle, e.identity);
+      }
+    }
+  }
+
+  for (auto& e : children.Value())
+  {
+    if (dirty.count(e.WindowHandle()) != 0)
+    {
+      continue;
+    }
+
+    auto title = e.Title();
+    if (!title)
+    {
+      ReportStateError(e, title.Error());
+      continue;
+    }
+
+    if (std::find(exclude.begin(), exclude.end(), title.Value()) !=
+        exclude.end())
+    {
+      continue;
+    }
+
+    XResult<WindowIdentity> identity;
+    if (auto it = identities.find(e.WindowHandle()); it != identities.end())
+    {
+      identity = *it->second;
+      identity.Value().title = std::move(title.Value());
+    }
+    else
     {
-      if (std::find(exclude.begin(), exclude.end(), e.Title()) == exclude.end())
+      identity = e.Identity(std::move(title.Value()));
+      if (identity && orphans.Claim(identity.Value()).has_value())
       {
-        windows.emplace_back(WindowState{e, e.CurrentPosition(), e.WmState()});
+        continue;
       }
     }
-    catch (const std::exception& ex)
+
+    if (!identity)
+    {
+      ReportStateError(e, identity.Error());
+      continue;
+    }
+
+    auto position = e.CurrentPosition();
+    if (!position)
     {
-      std::cerr << "Couldn't read state for window: " << e.WindowHandle()
-                << ", " << ex.what() << std::endl;
+      ReportStateError(e, position.Error());
+      continue;
     }
+
+    auto state = e.WmState();
+    if (!state)
+    {
+      ReportStateError(e, state.Error());
+      continue;
+    }
+
+    windows.emplace_back(WindowState{e,
+                                     std::move(identity.Value()),
+                                     position.Value(),
+                                     std::move(state.Value())});
   }
 
   return windows;
 }
 
-void RestoreWindows(std::vector<WindowState>& state)
+void RestoreWindows(Display* display,
+                    XWindow& root,
+                    const std::vector<std::string>& exclude,
+                    std::vector<WindowState>& state,
+                    const std::unordered_set<Window>& dirty)
 {
-  for (auto& e : state)
+  /*
+   * Windows might have been re-created since the snapshot, so saved positions
+   * are matched against the current client list by identity. Only windows
+   * that were on outputs that changed are restored
+   */
+  auto children = root.Children();
+  if (!children)
   {
-    try
+    std::cerr << "Couldn't list windows, " << children.Error() << std::endl;
+    return;
+  }
+
+  WindowIndex index;
+  for (const auto& e : state)
+  {
+    index.Add(e.window.WindowHandle(), e.identity);
+  }
+
+  auto is_dirty = [&](size_t id) {
+    return dirty.count(state[id].window.WindowHandle()) != 0;
+  };
+
+  RestorePass pass(display);
+  std::vector<XWindow> unmatched;
+  for (auto& e : children.Value())
+  {
+    if (XErrorTracker::Dead(e.WindowHandle()))
     {
-      std::cerr << "Restoring window: " << e.window.WindowHandle() << " ("
-                << e.window.Title() << ") -> " << e.position << std::endl;
+      continue;
+    }
 
-      e.window.SetPosition(e.position);
+    if (auto id = index.Claim(e.WindowHandle()); id.has_value())
+    {
+      if (is_dirty(id.value()))
+      {
+        pass.Add(e, state[id.value()].position, state[id.value()].state);
+      }
     }
-    catch (const std::exception& ex)
+    else
     {
-      std::cerr << "Error while restoring window: " << e.window.WindowHandle()
-                << ", " << ex.what() << std::endl;
+      unmatched.emplace_back(e);
+    }
+  }
+
+  for (auto& e : unmatched)
+  {
+    auto identity = e.Identity();
+    if (!identity || std::find(exclude.begin(),
+                               exclude.end(),
+                               identity.Value().title) != exclude.end())
+    {
+      continue;
+    }
+
+    if (auto id = index.Claim(identity.Value());
+        id.has_value() && is_dirty(id.value()))
+    {
+      std::cerr << "Matched re-created window: " << e.WindowHandle() << " ("
+                << identity.Value() << ")" << std::endl;
+
+      pass.Add(e, state[id.value()].position, state[id.value()].state);
     }
   }
+
+  pass.Run();
 }
 
-void ConsumeEvents(Display* display,
+void ConsumeEvents(XEventReader& reader,
+                   timepoint last_event_ts,
                    size_t timeout_ms,
-                   std::queue<XEvent>& events)
+                   std::queue<TimedEvent>& events)
 {
-  auto deadline =
-      std::chrono::system_clock::now() + std::chrono::milliseconds(timeout_ms);
+  /*
+   * Returns once no event arrived for timeout_ms. Events that are already
+   * queued count too, so they are drained before checking the deadline
+   */
+  auto latest = events.empty() ? last_event_ts
+                               : std::max(last_event_ts, events.back().received);
 
-  while (std::chrono::system_clock::now() < deadline)
+  while (true)
   {
-    while (XEventsQueued(display, QueuedAlready) > 0)
+    while (auto event = reader.Next())
+    {
+      events.emplace(event.value());
+      latest = std::max(latest, event->received);
+    }
+
+    if (std::chrono::system_clock::now() >=
+        latest + std::chrono::milliseconds(timeout_ms))
     {
-      events.emplace();
-      XNextEvent(display, &events.back());
-      deadline = std::chrono::system_clock::now() +
-                 std::chrono::milliseconds(timeout_ms);
+      return;
     }
 
     std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
 }
 
-XEvent NextEvent(Display* display, std::queue<XEvent>& queue)
+std::optional<TimedEvent> NextEvent(XEventReader& reader,
+                                    std::queue<TimedEvent>& queue)
 {
   if (queue.empty())
   {
-    XEvent event{};
-    XNextEvent(display, &event);
-    return event;
+    return reader.Next();
   }
   else
   {
-    XEvent event = queue.front();
+    TimedEvent event = queue.front();
     queue.pop();
 
     return event;
@@ -109,15 +280,9 @@ void Run(Display* display,
          int original_y,
          const std::vector<std::string>& exclude,
          const std::optional<std::string>& foreground_when_lost,
-         std::optional<size_t> foreground_delay_ms)
+         std::optional<size_t> foreground_delay_ms,
+         const std::optional<std::string>& export_name)
 {
-  if (XSelectInput(display, root.WindowHandle(), RRScreenChangeNotifyMask) == 0)
-  {
-    throw RuntimeError("XSelectInput failed");
-  }
-
-  XRRSelectInput(display, root.WindowHandle(), RRScreenChangeNotifyMask);
-
   int rr_event_base = 0;
   int rr_error_base = 0;
   if (!XRRQueryExtension(display, &rr_event_base, &rr_error_base))
@@ -125,29 +290,42 @@ void Run(Display* display,
     throw RuntimeError("X11 RR extension is not available");
   }
 
+  XEventReader reader;
+
+  std::optional<SnapshotExport> snapshot_export;
+  if (export_name.has_value())
+  {
+    snapshot_export.emplace(export_name.value());
+  }
+
   std::vector<WindowState> state;
+  OutputIndex outputs(display, root.WindowHandle());
+  std::unordered_set<Window> dirty;
   bool all_screens_present = true;
   timepoint last_event_ts;
-  std::queue<XEvent> queued_events;
+  std::queue<TimedEvent> queued_events;
   while (true)
   {
     /* Race condition: It's in theory possible that the resolution changed
-     * just after the last XPending() call. That's why we have this extra
+     * just after the queue was last drained. That's why we have this extra
      * timeout check here*/
     auto now = std::chrono::system_clock::now();
-    if (all_screens_present &&
-        (state.empty() ||
-         last_event_ts + std::chrono::milliseconds(event_timeout_ms) < now))
+    if (state.empty() ||
+        last_event_ts + std::chrono::milliseconds(event_timeout_ms) < now)
     {
-      state = GetWinddowsState(root, exclude);
+      state = GetWinddowsState(root, exclude, state, dirty);
+      if (snapshot_export.has_value())
+      {
+        snapshot_export->Publish(state, all_screens_present);
+      }
     }
 
     std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
-    while (!queued_events.empty() || XPending(display))
+    while (auto next = NextEvent(reader, queued_events))
     {
-      XEvent event = NextEvent(display, queued_events);
+      XEvent& event = next->event;
 
-      last_event_ts = std::chrono::system_clock::now();
+      last_event_ts = next->received;
       if (event.type != rr_event_base + RRScreenChangeNotify)
       {
         continue;
@@ -159,14 +337,35 @@ void Run(Display* display,
       bool original_screens = screen_event->width == original_x &&
                               screen_event->height == original_y;
 
+      OutputIndex current_outputs(display, root.WindowHandle());
+      if (!original_screens)
+      {
+        // Only windows on the outputs that changed need to be restored later.
+        // If the layouts can't be told apart, assume all windows are affected
+        auto changed = outputs.Changed(current_outputs);
+        bool unknown = outputs.Empty() || current_outputs.Empty() ||
+                       (all_screens_present && changed.Empty());
+
+        for (const auto& e : state)
+        {
+          if (unknown || changed.Intersects(e.position))
+          {
+            dirty.insert(e.window.WindowHandle());
+          }
+        }
+      }
+
+      outputs = std::move(current_outputs);
+
       if (!all_screens_present && original_screens)
       {
         std::cerr << "Original screens detected" << std::endl;
 
         // Wait a fixed amount of time to make sure all events are received
-        ConsumeEvents(display, resize_timeout_ms, queued_events);
+        ConsumeEvents(reader, last_event_ts, resize_timeout_ms, queued_events);
 
-        RestoreWindows(state);
+        RestoreWindows(display, root, exclude, state, dirty);
+        dirty.clear();
       }
       else if (all_screens_present && !original_screens)
       {
@@ -175,31 +374,33 @@ void Run(Display* display,
 
         for (auto& e : state)
         {
-          try
+          auto title = e.window.Title();
+          if (title && title.Value() == foreground_when_lost)
           {
+            if (foreground_delay_ms.has_value())
+            {
+              std::this_thread::sleep_for(
+                  std::chrono::milliseconds(foreground_delay_ms.value()));
+            }
 
-            if (e.window.Title() == foreground_when_lost)
+            if (auto result = e.window.Activate(); !result)
             {
-              if (foreground_delay_ms.has_value())
-              {
-                std::this_thread::sleep_for(
-                    std::chrono::milliseconds(foreground_delay_ms.value()));
-              }
-
-              e.window.Activate();
-              std::cerr << "Activated window: " << e.window.Title()
-                        << std::endl;
+              std::cerr << "Failed to activate window: " << title.Value()
+                        << ", " << result.Error() << std::endl;
               break;
             }
-          }
-          catch (const std::exception& e)
-          {
-            std::cerr << "Failed to get window title, " << e.what()
-                      << std::endl;
+
+            std::cerr << "Activated window: " << title.Value() << std::endl;
+            break;
           }
         }
       }
 
+      if (snapshot_export.has_value() && all_screens_present != original_screens)
+      {
+        snapshot_export->Publish(state, original_screens);
+      }
+
       all_screens_present = original_screens;
     }
   }
@@ -208,7 +409,7 @@ void Run(Display* display,
 void Help(const char* name)
 {
   const char* help =
-      "Usage: %s -x screen_witdh -y screen_height [--screen-timeout timeout_ms] [--refresh refresh_ms] [--exclude window1,window2] [--foreground_when_lost window] [--foreground-delay delay_ms]\n\
+      "Usage: %s -x screen_witdh -y screen_height [--screen-timeout timeout_ms] [--refresh refresh_ms] [--exclude window1,window2] [--foreground_when_lost window] [--foreground-delay delay_ms] [--export-shm name]\n\
 Options: \n\
 	-x: The width, in pixels of the original screen area\n\
 	-y: The height, in pixels of the original screen area\n\
@@ -217,6 +418,7 @@ Options: \n\
 	--refresh: The refresh rate at which windows are to be saved (in milliseconds)\n\
 	--foreground-when-lost: window to put to the foreground when screens are lost\n\
 	--foreground-delay: delay before moving window to foreground, in milliseconds\n\
+	--export-shm: name of a shared memory object to publish the saved windows and screen state in\n\
 	--help: Display this message\n";
 
   fprintf(stderr, help, name);
@@ -252,6 +454,7 @@ int main(int argc, char** argv)
                       {"foreground-when-lost", required_argument, 0, 'f'},
                       {"resize-timeout", required_argument, 0, 'i'},
                       {"foreground-delay", required_argument, 0, 'd'},
+                      {"export-shm", required_argument, 0, 'm'},
                       {"help", no_argument, 0, 'h'},
                       {0, 0, 0, 0}};
 
@@ -275,6 +478,7 @@ int main(int argc, char** argv)
   size_t screen_timeout = 2000;
   std::optional<std::string> foreground_when_lost;
   std::optional<size_t> foreground_delay;
+  std::optional<std::string> export_name;
 
   std::vector<std::string> exclude;
 
@@ -317,6 +521,10 @@ int main(int argc, char** argv)
         resize_timeout = parse_int(optarg);
         break;
 
+      case 'm':
+        export_name = optarg;
+        break;
+
       case 'e':
       {
 
@@ -331,12 +539,16 @@ int main(int argc, char** argv)
     }
   }
 
-  if (optind != argc || x == -1 || y == -1)
+  if (optind != argc || x == -1 || y == -1 ||
+      (export_name.has_value() && export_name->empty()))
   {
     Help(argv[0]);
     return 1;
   }
 
+  // The event reader uses its own connection from another thread
+  XInitThreads();
+
   auto* display = XOpenDisplay(nullptr);
   if (display == nullptr)
   {
@@ -344,7 +556,7 @@ int main(int argc, char** argv)
     return 1;
   }
 
-  XSetErrorHandler(OnX11Error);
+  XErrorTracker::Install(OnX11Error);
 
   Window root = XDefaultRootWindow(display);
 
@@ -357,7 +569,8 @@ int main(int argc, char** argv)
       y,
       exclude,
       foreground_when_lost,
-      foreground_delay);
+      foreground_delay,
+      export_name);
 
   XCloseDisplay(display);
 